@@ -11,6 +11,14 @@
 
 #define BUFFER_SIZE 256
 #define PI 3.14159265359
+#define BODY_BATCH_SIZE 256
+#define COLLIDE_ITERATIONS 4
+#define COLLIDE_SKIN 0.0001f
+#define WALL_CELL_SIZE 1.0f
+#define NAV_MAX_EDGE 0.5f
+#define NAV_CLUSTER_SIZE 32
+#define NAV_CELL_SIZE 1.0f
+#define NAV_CACHE_SIZE 4096
 
 using namespace std;
 
@@ -195,6 +203,106 @@ struct Tex2D {
 
 };
 
+// fork-join pool of worker threads, parallel_for hands out batches of a range to the workers and the calling thread
+struct JobSystem {
+
+    vector<thread> workers;
+
+    mutex m;
+    condition_variable start_cv, done_cv;
+    int generation; // bumped for every parallel_for so that workers know there is new work
+    int working; // workers that haven't finished the current parallel_for yet
+    bool quit;
+
+    function<void(int, int)> job;
+    int job_size, job_batch_size, job_batch_count;
+    atomic<int> next_batch;
+
+    JobSystem(int worker_count) {
+        generation = 0;
+        working = 0;
+        quit = false;
+        for (int i = 0; i < worker_count; i++) {
+            workers.push_back(thread([this]() { work(); }));
+        }
+    }
+
+    ~JobSystem() {
+        {
+            lock_guard<mutex> lock(m);
+            quit = true;
+        }
+        start_cv.notify_all();
+        for (thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    void work() {
+
+        int seen = 0;
+
+        while (true) {
+
+            {
+                unique_lock<mutex> lock(m);
+                start_cv.wait(lock, [&]() { return quit || generation != seen; });
+                if (quit) {
+                    return;
+                }
+                seen = generation;
+            }
+
+            run_batches();
+
+            {
+                lock_guard<mutex> lock(m);
+                working--;
+            }
+            done_cv.notify_one();
+
+        }
+
+    }
+
+    void run_batches() {
+        for (int b = next_batch++; b < job_batch_count; b = next_batch++) {
+            job(b * job_batch_size, min(job_size, (b + 1) * job_batch_size));
+        }
+    }
+
+    // calls f(begin, end) for consecutive ranges of at most batch_size indices covering [0, n), returns when all are done
+    void parallel_for(int n, int batch_size, function<void(int, int)> f) {
+
+        if (n <= batch_size || workers.empty()) {
+            if (n > 0) {
+                f(0, n);
+            }
+            return;
+        }
+
+        {
+            lock_guard<mutex> lock(m);
+            job = f;
+            job_size = n;
+            job_batch_size = batch_size;
+            job_batch_count = (n + batch_size - 1) / batch_size;
+            next_batch = 0;
+            working = workers.size();
+            generation++;
+        }
+        start_cv.notify_all();
+
+        run_batches();
+
+        // wait for every worker to check in, so none of them can still be reading this job when the next one starts
+        unique_lock<mutex> lock(m);
+        done_cv.wait(lock, [&]() { return working == 0; });
+
+    }
+
+};
+
 struct Player {
 
     glm::vec3 p;
@@ -246,6 +354,97 @@ struct Platform {
 
 };
 
+// key of cell (x, z) in the uniform grids
+long long cell_key(int x, int z) {
+    return ((long long)(unsigned int)x << 32) | (unsigned int)z;
+}
+
+// walls sorted into the cells of a uniform grid they pass through, so only walls near a body or segment get tested
+struct WallGrid {
+
+    vector<Wall> walls;
+    unordered_map<long long, vector<int>> cells;
+
+    WallGrid(vector<Wall>& walls) : walls(walls) {
+
+        for (int i = 0; i < walls.size(); i++) {
+
+            glm::vec2 a = walls[i].p1;
+            glm::vec2 b = walls[i].p2;
+            if (a.x > b.x) {
+                swap(a, b);
+            }
+
+            // walk the columns the wall crosses and add the cells of the part of it inside each column
+            for (int x = floor(a.x / WALL_CELL_SIZE); x <= floor(b.x / WALL_CELL_SIZE); x++) {
+
+                float x1 = max(a.x, x * WALL_CELL_SIZE);
+                float x2 = min(b.x, (x + 1) * WALL_CELL_SIZE);
+
+                float z1 = a.y, z2 = b.y;
+                if (b.x > a.x) {
+                    z1 = a.y + (b.y - a.y) * (x1 - a.x) / (b.x - a.x);
+                    z2 = a.y + (b.y - a.y) * (x2 - a.x) / (b.x - a.x);
+                }
+
+                for (int z = floor(min(z1, z2) / WALL_CELL_SIZE); z <= floor(max(z1, z2) / WALL_CELL_SIZE); z++) {
+                    cells[cell_key(x, z)].push_back(i);
+                }
+
+            }
+
+        }
+
+    }
+
+    // walls passing through the cells overlapping the box from lo to hi, each once and in index order
+    void walls_in_box(glm::vec2 lo, glm::vec2 hi, vector<int>& res) {
+
+        res.clear();
+
+        for (int x = floor(lo.x / WALL_CELL_SIZE); x <= floor(hi.x / WALL_CELL_SIZE); x++) {
+            for (int z = floor(lo.y / WALL_CELL_SIZE); z <= floor(hi.y / WALL_CELL_SIZE); z++) {
+                auto it = cells.find(cell_key(x, z));
+                if (it != cells.end()) {
+                    res.insert(res.end(), it->second.begin(), it->second.end());
+                }
+            }
+        }
+
+        sort(res.begin(), res.end());
+        res.erase(unique(res.begin(), res.end()), res.end());
+
+    }
+
+};
+
+// moving bodies (npcs, projectiles, props) stored as struct of arrays so every pass only loads the fields it uses
+struct Bodies {
+
+    vector<float> px, py, pz;
+    vector<float> vx, vy, vz;
+    vector<float> r, height;
+    vector<char> on_platform; // not vector<bool>, neighbouring bodies are written from different threads
+
+    int size() {
+        return px.size();
+    }
+
+    int add(glm::vec3 p, glm::vec3 v, float body_r, float body_height) {
+        px.push_back(p.x);
+        py.push_back(p.y);
+        pz.push_back(p.z);
+        vx.push_back(v.x);
+        vy.push_back(v.y);
+        vz.push_back(v.z);
+        r.push_back(body_r);
+        height.push_back(body_height);
+        on_platform.push_back(false);
+        return size() - 1;
+    }
+
+};
+
 bool point_in_polygon(glm::vec2 p, vector<glm::vec2>& polygon_vertices) {
 
     // cast a ray to +x direction and check if intersections with polygon edges is even or odd
@@ -365,300 +564,1218 @@ bool lines_intersect(glm::vec2 p1, glm::vec2 q1, glm::vec2 p2, glm::vec2 q2) {
 
 }
 
+float cross_2d(glm::vec2 a, glm::vec2 b) {
+    return a.x * b.y - a.y * b.x;
+}
 
-void wall_to_mesh(vector<float>& vertices, Wall wall) {
+glm::vec2 closest_point_on_segment(glm::vec2 p, glm::vec2 a, glm::vec2 b) {
 
-    vertices.insert(vertices.end(), {
-        
-        wall.p1.x, wall.y_lo, wall.p1.y,
-        wall.p2.x, wall.y_lo, wall.p2.y,
-        wall.p2.x, wall.y_hi, wall.p2.y,
+    glm::vec2 ab = b - a;
+    float len2 = glm::dot(ab, ab);
 
-        wall.p1.x, wall.y_lo, wall.p1.y,
-        wall.p1.x, wall.y_hi, wall.p1.y,
-        wall.p2.x, wall.y_hi, wall.p2.y,
+    if (len2 == 0) {
+        return a;
+    }
 
-    });
+    float t = glm::clamp(glm::dot(p - a, ab) / len2, 0.0f, 1.0f);
+    return a + ab * t;
 
 }
 
-void platform_to_mesh(vector<float>& vertices, Platform platform) {
+// closest points a and b of two segments, returns the distance between them which is zero if they cross
+float segment_closest_points(glm::vec2 p1, glm::vec2 q1, glm::vec2 p2, glm::vec2 q2, glm::vec2& a, glm::vec2& b) {
 
-    // use ear trimming method
+    float o1 = cross_2d(q1 - p1, p2 - p1);
+    float o2 = cross_2d(q1 - p1, q2 - p1);
+    float o3 = cross_2d(q2 - p2, p1 - p2);
+    float o4 = cross_2d(q2 - p2, q1 - p2);
 
-    vector<pair<float, float>> vertices_c;
-    for (int i = 0; i < platform.polygon_vertices.size(); i++) {
-        vertices_c.push_back({platform.polygon_vertices[i].x, platform.polygon_vertices[i].y});
+    if (o1 * o2 < 0 && o3 * o4 < 0) {
+        float t = o3 / (o3 - o4);
+        a = p1 + (q1 - p1) * t;
+        b = a;
+        return 0.0;
     }
 
-    while (vertices_c.size() >= 4) {
+    // otherwise one of the endpoints is part of the closest pair
+    glm::vec2 candidates[4][2] = {
+        {p1, closest_point_on_segment(p1, p2, q2)},
+        {q1, closest_point_on_segment(q1, p2, q2)},
+        {closest_point_on_segment(p2, p1, q1), p2},
+        {closest_point_on_segment(q2, p1, q1), q2},
+    };
+
+    float best = INFINITY;
+    for (int i = 0; i < 4; i++) {
+        float d = glm::length(candidates[i][0] - candidates[i][1]);
+        if (d < best) {
+            best = d;
+            a = candidates[i][0];
+            b = candidates[i][1];
+        }
+    }
 
-        for (int i = 0; i < vertices_c.size(); i++) {
-            
-            bool is_ear = true;
+    return best;
 
-            pair<float, float> A = vertices_c[(i-1)%vertices_c.size()];
-            pair<float, float> B = vertices_c[i];
-            pair<float, float> C = vertices_c[(i+1)%vertices_c.size()];
+}
 
-            for (int j = 0; j < vertices_c.size(); j++) {
-                if (j != (i-1)%vertices_c.size() && j != i && j != (i+1)%vertices_c.size()) {
-                    glm::vec2 p2 = {vertices_c[j].first, vertices_c[j].second};
-                    glm::vec2 q2 = {vertices_c[(j+1)%vertices_c.size()].first, vertices_c[(j+1)%vertices_c.size()].second};
-                    if (lines_intersect({A.first, A.second}, {C.first, C.second}, p2, q2)) {
-                        is_ear = false;
-                    }
-                }
-            }
+float segment_distance(glm::vec2 p1, glm::vec2 q1, glm::vec2 p2, glm::vec2 q2) {
+    glm::vec2 a, b;
+    return segment_closest_points(p1, q1, p2, q2, a, b);
+}
 
-            if (is_ear) {
-                vertices_c.erase(vertices_c.begin()+i);
-                vertices.insert(vertices.end(), {
-                    A.first, platform.y, A.second,
-                    B.first, platform.y, B.second,
-                    C.first, platform.y, C.second
-                });
-                break;
-            }
+bool point_in_triangle(glm::vec2 p, glm::vec2 a, glm::vec2 b, glm::vec2 c) {
 
-        }
+    float d1 = cross_2d(b - a, p - a);
+    float d2 = cross_2d(c - b, p - b);
+    float d3 = cross_2d(a - c, p - c);
 
-    }
+    bool has_neg = d1 < 0 || d2 < 0 || d3 < 0;
+    bool has_pos = d1 > 0 || d2 > 0 || d3 > 0;
 
-    vertices.insert(vertices.end(), {
-        vertices_c[0].first, platform.y, vertices_c[0].second,
-        vertices_c[1].first, platform.y, vertices_c[1].second,
-        vertices_c[2].first, platform.y, vertices_c[2].second,
-    });
+    return !(has_neg && has_pos);
 
 }
 
-int main() {
+glm::vec2 closest_point_on_triangle(glm::vec2 p, glm::vec2 a, glm::vec2 b, glm::vec2 c) {
 
-    if (!glfwInit()) {
-        cerr << "GLFW init failed." << endl;
-        exit(1);
+    if (point_in_triangle(p, a, b, c)) {
+        return p;
     }
 
-    int ww = 800;
-    int wh = 800;
-
-    GLFWwindow* window;
-    window = glfwCreateWindow(ww, wh, "this is a window", NULL, NULL);
-    glfwMakeContextCurrent(window);
-
-    if (glewInit() != GLEW_OK) {
-        cerr << "GLEW init failed." << endl;
-        exit(1);
+    glm::vec2 res = closest_point_on_segment(p, a, b);
+    for (glm::vec2 q : {closest_point_on_segment(p, b, c), closest_point_on_segment(p, c, a)}) {
+        if (glm::length(q - p) < glm::length(res - p)) {
+            res = q;
+        }
     }
 
-    ShaderProgram worldspace_program("../src/shaders/worldspace.vert", "../src/shaders/worldspace.frag", {
-        "tex",
-        "view_mat",
-        "project_mat",
-    });
-    worldspace_program.use();
-
-    ShaderProgram default_program("../src/shaders/default.vert", "../src/shaders/default.frag", {
-        "tex"
-    });
-
-    Tex2D tex("../textures/bricks.png");
+    return res;
 
-    vector<float> vertices = {
-        // -1.0f, -1.0f, 1.0f,
-        // 1.0f, -1.0f, 1.0f,
-        // 1.0f, 1.0f, 1.0f,
-        // -1.0f, -1.0f, 1.0f,
-        // -1.0f, 1.0f, 1.0f,
-        // 1.0f, 1.0f, 1.0f,
-    };
+}
 
-    
+// lands a body that is height tall on the platforms it crossed during the last step, or stops it under them
+void collide_platforms(glm::vec3& p, glm::vec3& v, float height, bool& on_platform, float dt, vector<Platform>& platforms) {
 
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    double mx, my;
-    glfwGetCursorPos(window, &mx, &my);
+    on_platform = false;
 
+    for (Platform& platform : platforms) {
 
-    // player and level stuff
-    float g = 2.0;
-    float max_v = 5.0f;
-    Player plr(glm::vec3(0.0, 1.0, 0.0));
+        float y1 = p.y - v.y * dt;
+        float y2 = p.y;
 
-    vector<Platform> platforms;
-    platforms.push_back(Platform(-1.0f, {{-1.0, -1.0}, {1.0, -1.0}, {1.0, 1.0}, {-1.0, 1.0}, {0.0, 0.0}}));
+        if (platform.y >= min(y1, y2) - height / 2 && platform.y <= max(y1, y2) + height / 2) {
 
-    vector<Wall> walls;
-    walls.push_back(Wall({-1.0, 1.0}, {2.0, 1.0}, -1.0, 1.0));
-    walls.push_back(Wall({-1.0, 1.0}, {-1.0, -1.0}, -1.0, 1.0));
+            if (point_in_polygon(glm::vec2(p.x, p.z), platform.polygon_vertices)) {
+                if (v.y > 0 && y1 + height / 2 <= platform.y && y2 + height / 2 >= platform.y) {
+                    v.y = 0.0;
+                    on_platform = true;
+                    p.y = platform.y - height / 2;
+                } else if (v.y < 0 && y1 - height / 2 >= platform.y && y2 - height / 2 <= platform.y) {
+                    v.y = 0.0;                        
+                    on_platform = true;
+                    p.y = platform.y + height / 2;
+                }
+            }
 
-    for (Wall wall : walls) {
-        wall_to_mesh(vertices, wall);
-    }
+        }
 
-    for (Platform platform : platforms) {
-        platform_to_mesh(vertices, platform);
     }
 
+}
 
-    VAO vao;
-    vao.bind();
-
-    VBO vbo(vertices);
-    // EBO ebo(indices);
+// earliest time t in [0, 1] when a circle of radius r moving from p by d touches the segment a to b,
+// the segment has rounded ends so corners are hit as well, normal points from the segment to the circle
+bool sweep_circle_segment(glm::vec2 p, glm::vec2 d, float r, glm::vec2 a, glm::vec2 b, float& t, glm::vec2& normal) {
 
-    vao.link_VBO(vbo, 0, 3);
-    vao.unbind();
-    vbo.unbind();
+    glm::vec2 ab = b - a;
+    glm::vec2 n = glm::normalize(glm::vec2(-ab.y, ab.x));
 
-    glEnable(GL_DEPTH_TEST);
+    // already touching, only a hit if moving further in
+    glm::vec2 closest = closest_point_on_segment(p, a, b);
+    float dist = glm::length(p - closest);
+    if (dist < r) {
+        normal = dist > 0 ? (p - closest) / dist : (glm::dot(d, n) > 0 ? -n : n);
+        if (glm::dot(d, normal) >= 0) {
+            return false;
+        }
+        t = 0.0;
+        return true;
+    }
 
-    // glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
+    bool hit = false;
+    t = INFINITY;
 
-    double time_when_fps = glfwGetTime();
-    int updates_since_fps = 0;
-    float dt = 0.0f;
+    // flat side facing the circle
+    float side = glm::dot(p - a, n);
+    if (side < 0) {
+        n = -n;
+        side = -side;
+    }
+    float approach = -glm::dot(d, n);
+    if (approach > 0) {
+        float ts = (side - r) / approach;
+        float s = glm::dot(p + d * ts - a, ab) / glm::dot(ab, ab);
+        if (ts >= 0 && ts <= 1 && s >= 0 && s <= 1) {
+            t = ts;
+            normal = n;
+            hit = true;
+        }
+    }
 
-    while (!glfwWindowShouldClose(window)) {
-        
-        float time_start = glfwGetTime();
+    // rounded ends
+    float dd = glm::dot(d, d);
+    if (dd > 0) {
+        for (glm::vec2 end : {a, b}) {
+            glm::vec2 m = p - end;
+            float half_b = glm::dot(m, d);
+            float c = glm::dot(m, m) - r * r;
+            float disc = half_b * half_b - dd * c;
+            if (half_b >= 0 || disc < 0) {
+                continue;
+            }
+            float te = (-half_b - sqrt(disc)) / dd;
+            if (te <= 1 && te < t) {
+                t = te;
+                normal = glm::normalize(p + d * te - end);
+                hit = true;
+            }
+        }
+    }
 
-        glfwPollEvents();
+    return hit;
 
-        double n_mx, n_my;
-        glfwGetCursorPos(window, &n_mx, &n_my);
-        double dmx = n_mx - mx;
-        double dmy = n_my - my;
-        mx = n_mx;
-        my = n_my;
+}
 
-        plr.yaw -= dmx / 100;
-        plr.pitch -= dmy / 100;
-        plr.pitch = min(plr.pitch, (float)PI/2);
-        plr.pitch = max(plr.pitch, -(float)PI/2);
+// moves a body of radius r that went from p - v * dt to p back to where it first touched a wall, and lets it slide along
+// the walls it touches for the rest of the step, the part of v going into the walls is removed
+void collide_walls(glm::vec3& p, glm::vec3& v, float r, float height, float dt, WallGrid& walls) {
 
-        plr.v.x = 0.0;
-        plr.v.z = 0.0;
-        plr.v.y -= g * dt;
-        plr.v.y = max(plr.v.y, -max_v);
+    glm::vec2 pos(p.x - v.x * dt, p.z - v.z * dt);
+    glm::vec2 move(v.x * dt, v.z * dt);
+    glm::vec2 vel(v.x, v.z);
 
-        if (glfwGetKey(window, GLFW_KEY_ESCAPE)) {
-            break;
-        }
-        if (glfwGetKey(window, GLFW_KEY_W)) {
-            plr.v.z -= cos(plr.yaw) * plr.speed;
-            plr.v.x -= sin(plr.yaw) * plr.speed;
-        }
-        if (glfwGetKey(window, GLFW_KEY_S)) {
-            plr.v.z += cos(plr.yaw) * plr.speed;
-            plr.v.x += sin(plr.yaw) * plr.speed;
-        }
-        if (glfwGetKey(window, GLFW_KEY_D)) {
-            plr.v.z += -sin(plr.yaw) * plr.speed;
-            plr.v.x += cos(plr.yaw) * plr.speed;
-        }
-        if (glfwGetKey(window, GLFW_KEY_A)) {
-            plr.v.z -= -sin(plr.yaw) * plr.speed;
-            plr.v.x -= cos(plr.yaw) * plr.speed;
-        }
-        if (glfwGetKey(window, GLFW_KEY_SPACE)) {
-            if (plr.on_platform) {
-               plr.v.y = 1.0;
-               plr.on_platform = false;
-            }
-            // plr.v.y += dt * plr.speed;
-        }
-        // if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT)) {
-        //     plr.v.y -= dt * plr.speed;
-        // }
+    // heights the body covered during the step, the end of it can be below walls that it went through on the way down
+    float y1 = p.y - v.y * dt;
+    float y2 = p.y;
+    float y_lo = min(y1, y2) - height / 2;
+    float y_hi = max(y1, y2) + height / 2;
 
-        plr.p += plr.v * dt;
+    // sliding never takes the body further from the start than the length of the move, so walls outside that can't be hit
+    thread_local vector<int> near;
+    float range = glm::length(move) + r + COLLIDE_ITERATIONS * COLLIDE_SKIN;
+    walls.walls_in_box(pos - glm::vec2(range), pos + glm::vec2(range), near);
 
-        plr.on_platform = false;
+    for (int i = 0; i < COLLIDE_ITERATIONS; i++) {
 
-        for (Platform platform : platforms) {
+        float t_hit = INFINITY;
+        glm::vec2 n_hit;
 
-            float y1 = plr.p.y - plr.v.y * dt;
-            float y2 = plr.p.y;
+        for (int w : near) {
 
-            if (platform.y >= min(y1, y2) - plr.height / 2 && platform.y <= max(y1, y2) + plr.height / 2) {
+            Wall& wall = walls.walls[w];
 
-                if (point_in_polygon(glm::vec2(plr.p.x, plr.p.z), platform.polygon_vertices)) {
-                    if (plr.v.y > 0 && y1 + plr.height / 2 <= platform.y && y2 + plr.height / 2 >= platform.y) {
-                        plr.v.y = 0.0;
-                        plr.on_platform = true;
-                        plr.p.y = platform.y - plr.height / 2;
-                    } else if (plr.v.y < 0 && y1 - plr.height / 2 >= platform.y && y2 - plr.height / 2 <= platform.y) {
-                        plr.v.y = 0.0;                        
-                        plr.on_platform = true;
-                        plr.p.y = platform.y + plr.height / 2;
-                    }
-                }
+            if (y_lo > wall.y_hi || y_hi < wall.y_lo) {
+                continue;
+            }
 
+            float t;
+            glm::vec2 normal;
+            if (sweep_circle_segment(pos, move, r, wall.p1, wall.p2, t, normal) && t < t_hit) {
+                t_hit = t;
+                n_hit = normal;
             }
 
         }
 
-        if (!(plr.v.x == 0 && plr.v.z == 0)) {
+        if (t_hit == INFINITY) {
+            pos += move;
+            move = glm::vec2(0.0);
+            break;
+        }
 
-            for (Wall wall : walls) {
+        // stop where it touched, keep a small gap so the next sweep doesn't start inside the wall, then slide
+        pos += move * max(t_hit, 0.0f) + n_hit * COLLIDE_SKIN;
+        move *= 1 - max(t_hit, 0.0f);
+        move -= n_hit * glm::dot(move, n_hit);
 
-                if (plr.p.y - plr.height / 2 > wall.y_hi || plr.p.y + plr.height / 2 < wall.y_lo) {
-                    continue;
-                }
+        float into = glm::dot(vel, n_hit);
+        if (into < 0) {
+            vel -= n_hit * into;
+        }
 
-                // float orientation;
-                // if (glm::length(glm::vec2(plr.p.x, plr.p.z) - (wall.p1 + wall.normal)) > glm::length(glm::vec2(plr.p.x, plr.p.z) - (wall.p1 - wall.normal))) {
-                //     orientation = 1.0;
-                // } else {
-                //     orientation = -1.0;
-                // }
+    }
 
-                float orientation = glm::dot(glm::vec2(plr.v.x, plr.v.z), wall.normal);
-                orientation /= abs(orientation);
+    // walls around a corner can take more than COLLIDE_ITERATIONS slides, whatever is left of the move is dropped
 
-                glm::vec2 p1 = wall.p1 - wall.normal * plr.r * orientation;
-                glm::vec2 q1 = wall.p2 - wall.normal * plr.r * orientation;
+    p.x = pos.x;
+    p.z = pos.y;
+    v.x = vel.x;
+    v.z = vel.y;
 
-                glm::vec2 p2 = glm::vec2(plr.p.x - plr.v.x * dt, plr.p.z - plr.v.z * dt);
-                glm::vec2 q2 = glm::vec2(plr.p.x, plr.p.z);
+}
 
-                if (lines_intersect(p1, q1, p2, q2)) {
+// applies gravity and moves bodies in [begin, end) the same way as the player
+void integrate_bodies(Bodies& bodies, int begin, int end, float g, float max_v, float dt) {
 
-                    float a = wall.normal.x;
-                    float b = wall.normal.y;
-                    float c = -a * p1.x - b * p1.y;
+    for (int i = begin; i < end; i++) {
+        bodies.vy[i] -= g * dt;
+        bodies.vy[i] = max(bodies.vy[i], -max_v);
+    }
 
-                    float d = abs(a * plr.p.x + b * plr.p.z + c) / sqrt(a*a + b*b);
+    for (int i = begin; i < end; i++) {
+        bodies.px[i] += bodies.vx[i] * dt;
+        bodies.py[i] += bodies.vy[i] * dt;
+        bodies.pz[i] += bodies.vz[i] * dt;
+    }
 
-                    plr.p.x -= (d+0.00001) * wall.normal.x * orientation;
-                    plr.p.z -= (d+0.00001) * wall.normal.y * orientation;
+}
 
-                } else {
+// collides bodies in [begin, end) with the level, every body only depends on itself so the split between threads doesn't change the result
+void collide_bodies(Bodies& bodies, int begin, int end, float dt, vector<Platform>& platforms, WallGrid& walls) {
 
-                    // glm::vec2 v1 = wall.p1 - glm::vec2(plr.p.x, plr.p.z);
-                    // glm::vec2 v2 = wall.p2 - glm::vec2(plr.p.x, plr.p.z);
+    for (int i = begin; i < end; i++) {
 
-                    // float d1 = glm::length(v1);
-                    // float d2 = glm::length(v2);
+        glm::vec3 p(bodies.px[i], bodies.py[i], bodies.pz[i]);
+        glm::vec3 v(bodies.vx[i], bodies.vy[i], bodies.vz[i]);
+        bool on_platform;
 
-                    // if (d1 < plr.r) {
-                    //     glm::vec2 displace = glm::normalize(v1) * (plr.r - d1 + 0.001f);
-                    //     plr.p.x -= displace.x;
-                    //     plr.p.z -= displace.y;
-                    // }
-                    // if (d2 < plr.r) {
-                    //     glm::vec2 displace = glm::normalize(v2) * (plr.r - d2 + 0.001f);
-                    //     plr.p.x -= displace.x;
-                    //     plr.p.z -= displace.y;
-                    // }
+        collide_walls(p, v, bodies.r[i], bodies.height[i], dt, walls);
+        collide_platforms(p, v, bodies.height[i], on_platform, dt, platforms);
 
-                }
+        bodies.px[i] = p.x;
+        bodies.py[i] = p.y;
+        bodies.pz[i] = p.z;
+        bodies.vx[i] = v.x;
+        bodies.vy[i] = v.y;
+        bodies.vz[i] = v.z;
+        bodies.on_platform[i] = on_platform;
 
-            }
+    }
 
-        }
+}
+
+
+void wall_to_mesh(vector<float>& vertices, Wall wall) {
+
+    vertices.insert(vertices.end(), {
+        
+        wall.p1.x, wall.y_lo, wall.p1.y,
+        wall.p2.x, wall.y_lo, wall.p2.y,
+        wall.p2.x, wall.y_hi, wall.p2.y,
+
+        wall.p1.x, wall.y_lo, wall.p1.y,
+        wall.p1.x, wall.y_hi, wall.p1.y,
+        wall.p2.x, wall.y_hi, wall.p2.y,
+
+    });
+
+}
+
+// triangulates a simple polygon, every three consecutive vertices of the result make up a triangle
+vector<glm::vec2> triangulate_polygon(vector<glm::vec2> polygon_vertices) {
+
+    // use ear trimming method
+
+    vector<glm::vec2> triangles;
+
+    // sign of the area tells the winding order, an ear has to turn the same way as the polygon
+    float area = 0.0;
+    for (int i = 0; i < polygon_vertices.size(); i++) {
+        glm::vec2 p1 = polygon_vertices[i];
+        glm::vec2 p2 = polygon_vertices[(i+1) % polygon_vertices.size()];
+        area += p1.x * p2.y - p2.x * p1.y;
+    }
+
+    while (polygon_vertices.size() >= 4) {
+
+        int n = polygon_vertices.size();
+        bool found_ear = false;
+
+        for (int i = 0; i < n; i++) {
+
+            glm::vec2 A = polygon_vertices[(i-1+n)%n];
+            glm::vec2 B = polygon_vertices[i];
+            glm::vec2 C = polygon_vertices[(i+1)%n];
+
+            float turn = (B.x - A.x) * (C.y - B.y) - (B.y - A.y) * (C.x - B.x);
+            bool is_ear = turn * area > 0;
+
+            // no other vertex can be inside the ear or on its edges
+            for (int j = 0; j < n && is_ear; j++) {
+                glm::vec2 P = polygon_vertices[j];
+                if (P != A && P != B && P != C && point_in_triangle(P, A, B, C)) {
+                    is_ear = false;
+                }
+            }
+
+            if (is_ear) {
+                polygon_vertices.erase(polygon_vertices.begin()+i);
+                triangles.insert(triangles.end(), {A, B, C});
+                found_ear = true;
+                break;
+            }
+
+        }
+
+        // degenerate polygon, nothing more can be trimmed
+        if (!found_ear) {
+            break;
+        }
+
+    }
+
+    if (polygon_vertices.size() == 3) {
+        triangles.insert(triangles.end(), polygon_vertices.begin(), polygon_vertices.end());
+    }
+
+    return triangles;
+
+}
+
+void platform_to_mesh(vector<float>& vertices, Platform platform) {
+
+    for (glm::vec2 v : triangulate_polygon(platform.polygon_vertices)) {
+        vertices.insert(vertices.end(), {v.x, platform.y, v.y});
+    }
+
+}
+
+// splits triangles in half across their longest edge until no edge is longer than max_edge
+vector<glm::vec2> subdivide_triangles(vector<glm::vec2> triangles, float max_edge) {
+
+    vector<glm::vec2> res;
+
+    while (triangles.size() >= 3) {
+
+        glm::vec2 c = triangles.back();
+        triangles.pop_back();
+        glm::vec2 b = triangles.back();
+        triangles.pop_back();
+        glm::vec2 a = triangles.back();
+        triangles.pop_back();
+
+        // rotate the vertices so that a to b is the longest edge
+        float ab = glm::length(b - a);
+        float bc = glm::length(c - b);
+        float ca = glm::length(a - c);
+        if (bc > ab && bc >= ca) {
+            tie(a, b, c) = make_tuple(b, c, a);
+        } else if (ca > ab && ca > bc) {
+            tie(a, b, c) = make_tuple(c, a, b);
+        }
+
+        if (glm::length(b - a) <= max_edge) {
+            res.insert(res.end(), {a, b, c});
+            continue;
+        }
+
+        glm::vec2 m = (a + b) * 0.5f;
+        triangles.insert(triangles.end(), {a, m, c, m, b, c});
+
+    }
+
+    return res;
+
+}
+
+// what the agents a navigation mesh is built for are able to do
+struct NavAgent {
+
+    float r;
+    float height;
+    float speed;
+    float g;
+    float jump_v;
+    float step_height; // height difference between platforms that can be walked over, agents can't climb ledges
+    float max_drop; // highest drop still considered a way down
+
+    NavAgent(Player& plr, float g, float jump_v) : g(g), jump_v(jump_v) {
+        r = plr.r;
+        height = plr.height;
+        speed = plr.speed;
+        step_height = 0.01;
+        max_drop = 4.0 * plr.height;
+    }
+
+    float jump_height() {
+        return jump_v * jump_v / (2 * g);
+    }
+
+    // horizontal distance covered by a jump that lands dy higher than it started
+    float jump_reach(float dy) {
+        float d = jump_v * jump_v - 2 * g * dy;
+        if (d < 0) {
+            return 0.0;
+        }
+        return speed * (jump_v + sqrt(d)) / g;
+    }
+
+};
+
+// triangle of a platform that agents can stand on
+struct NavPoly {
+
+    glm::vec2 v[3];
+    float y;
+    int platform;
+    int cluster;
+    bool boundary[3]; // edge from v[i] to v[i+1] isn't shared with another triangle of the same platform
+    bool blocked; // too close to a wall to stand in the middle of
+    glm::vec3 centre; // position of an agent standing in the middle of the triangle
+
+};
+
+// way from one node of a navigation graph to another, leaving the first node at p1 and arriving in the other at p2
+struct NavLink {
+
+    int to;
+    float cost;
+    glm::vec3 p1, p2;
+
+};
+
+// connected triangles of one platform, paths are searched between clusters first and then refined inside them
+struct NavCluster {
+
+    glm::vec3 centre;
+    vector<int> polys;
+
+};
+
+// A* state kept between searches on the same thread, an entry only counts if its stamp is the current search's
+struct NavSearch {
+
+    vector<float> cost;
+    vector<int> prev;
+    vector<char> closed;
+    vector<int> stamp;
+    int generation = 0;
+
+    void begin(int n) {
+        if (stamp.size() < n) {
+            cost.resize(n);
+            prev.resize(n);
+            closed.resize(n);
+            stamp.resize(n, 0);
+        }
+        generation++;
+        if (generation == INT_MAX) {
+            fill(stamp.begin(), stamp.end(), 0);
+            generation = 1;
+        }
+    }
+
+    void touch(int u) {
+        if (stamp[u] != generation) {
+            stamp[u] = generation;
+            cost[u] = INFINITY;
+            prev[u] = -1;
+            closed[u] = 0;
+        }
+    }
+
+};
+
+// A* search between nodes that have a centre, only visits nodes that allowed(i) is true for
+template<typename T, typename F>
+bool a_star(vector<T>& nodes, vector<vector<NavLink>>& links, int start, int goal, F allowed, vector<int>& path) {
+
+    // reused so a search only costs as much as the nodes it visits, not the size of the whole graph
+    thread_local NavSearch search;
+    search.begin(nodes.size());
+
+    priority_queue<pair<float, int>, vector<pair<float, int>>, greater<pair<float, int>>> open;
+
+    search.touch(start);
+    search.touch(goal);
+    search.cost[start] = 0.0;
+    open.push({glm::length(nodes[goal].centre - nodes[start].centre), start});
+
+    while (!open.empty()) {
+
+        int u = open.top().second;
+        open.pop();
+
+        if (u == goal) {
+            break;
+        }
+        if (search.closed[u]) {
+            continue;
+        }
+        search.closed[u] = 1;
+
+        for (NavLink& link : links[u]) {
+
+            if (!allowed(link.to)) {
+                continue;
+            }
+
+            search.touch(link.to);
+            if (search.closed[link.to]) {
+                continue;
+            }
+
+            float c = search.cost[u] + link.cost;
+            if (c < search.cost[link.to]) {
+                search.cost[link.to] = c;
+                search.prev[link.to] = u;
+                open.push({c + glm::length(nodes[goal].centre - nodes[link.to].centre), link.to});
+            }
+
+        }
+
+    }
+
+    if (search.cost[goal] == INFINITY) {
+        return false;
+    }
+
+    path.clear();
+    for (int u = goal; u != -1; u = search.prev[u]) {
+        path.push_back(u);
+    }
+    reverse(path.begin(), path.end());
+
+    return true;
+
+}
+
+// navigation mesh made of the triangulated platforms, linked where agents can walk, step, drop or jump between them
+struct NavMesh {
+
+    NavAgent agent;
+    WallGrid walls;
+
+    vector<NavPoly> polys;
+    vector<vector<NavLink>> links; // outgoing links of every triangle
+
+    vector<NavCluster> clusters;
+    vector<vector<NavLink>> cluster_links;
+
+    // triangles overlapping each cell of a uniform grid, for finding which triangle a point is on
+    unordered_map<long long, vector<int>> grid;
+
+    // cluster paths found by earlier searches, an empty path means the goal can't be reached
+    unordered_map<long long, vector<int>> corridor_cache;
+    mutex cache_mutex;
+
+    NavMesh(vector<Platform>& platforms, vector<Wall>& walls, NavAgent agent, JobSystem& jobs) : agent(agent), walls(walls) {
+
+        // runs f for every index on the job system, each index only writes its own results so the split doesn't matter
+        auto parallel_for = [&](int n, function<void(int)> f) {
+            jobs.parallel_for(n, 1, [&](int begin, int end) {
+                for (int i = begin; i < end; i++) {
+                    f(i);
+                }
+            });
+        };
+
+        vector<vector<glm::vec2>> triangulations(platforms.size());
+        parallel_for(platforms.size(), [&](int i) {
+            // small triangles so that a wall crossing a platform only cuts off the few it passes through
+            triangulations[i] = subdivide_triangles(triangulate_polygon(platforms[i].polygon_vertices), NAV_MAX_EDGE);
+        });
+
+        for (int i = 0; i < platforms.size(); i++) {
+
+            for (int j = 0; j + 2 < triangulations[i].size(); j += 3) {
+
+                NavPoly poly;
+                poly.y = platforms[i].y;
+                poly.platform = i;
+                poly.cluster = -1;
+                poly.blocked = false;
+
+                glm::vec2 sum(0.0);
+                for (int k = 0; k < 3; k++) {
+                    poly.v[k] = triangulations[i][j+k];
+                    poly.boundary[k] = true;
+                    sum += poly.v[k];
+                }
+                poly.centre = glm::vec3(sum.x / 3, poly.y + agent.height / 2, sum.y / 3);
+
+                polys.push_back(poly);
+
+            }
+
+        }
+
+        for (int i = 0; i < polys.size(); i++) {
+            for (int x = floor(poly_lo(i).x / NAV_CELL_SIZE); x <= floor(poly_hi(i).x / NAV_CELL_SIZE); x++) {
+                for (int z = floor(poly_lo(i).y / NAV_CELL_SIZE); z <= floor(poly_hi(i).y / NAV_CELL_SIZE); z++) {
+                    grid[cell_key(x, z)].push_back(i);
+                }
+            }
+        }
+
+        // neighbours and platforms within reach are looked up in the grid, the furthest any link can go is a jump down
+        float max_reach = max(agent.r, agent.jump_reach(-agent.max_drop));
+
+        parallel_for(polys.size(), [&](int i) {
+            glm::vec2 c(polys[i].centre.x, polys[i].centre.z);
+            polys[i].blocked = walkway_blocked(c, c, polys[i].y, polys[i].y + agent.height);
+        });
+
+        links.resize(polys.size());
+        parallel_for(polys.size(), [&](int i) {
+
+            NavPoly& poly = polys[i];
+            glm::vec2 c1(poly.centre.x, poly.centre.z);
+
+            vector<int> near;
+
+            // neighbouring triangles of the same platform, edges are shared partly where splitting left T-junctions
+            polys_in_box(poly_lo(i), poly_hi(i), near);
+            for (int j : near) {
+
+                if (j == i || polys[j].platform != poly.platform) {
+                    continue;
+                }
+
+                glm::vec2 c2(polys[j].centre.x, polys[j].centre.z);
+
+                for (int e = 0; e < 3; e++) {
+                    for (int k = 0; k < 3; k++) {
+
+                        glm::vec2 a = poly.v[e];
+                        glm::vec2 b = poly.v[(e+1)%3];
+                        glm::vec2 c = polys[j].v[k];
+                        glm::vec2 d = polys[j].v[(k+1)%3];
+
+                        float len = glm::length(b - a);
+                        glm::vec2 dir = (b - a) / len;
+
+                        if (abs(cross_2d(dir, c - a)) > 1e-4 || abs(cross_2d(dir, d - a)) > 1e-4) {
+                            continue;
+                        }
+
+                        float t1 = max(0.0f, min(glm::dot(dir, c - a), glm::dot(dir, d - a)));
+                        float t2 = min(len, max(glm::dot(dir, c - a), glm::dot(dir, d - a)));
+                        if (t2 - t1 < 1e-4) {
+                            continue;
+                        }
+
+                        poly.boundary[e] = false;
+
+                        if (poly.blocked || polys[j].blocked) {
+                            continue;
+                        }
+
+                        glm::vec2 mid = a + dir * ((t1 + t2) / 2);
+
+                        if (walkway_blocked(c1, mid, poly.y, poly.y + agent.height) || walkway_blocked(mid, c2, poly.y, poly.y + agent.height)) {
+                            continue;
+                        }
+
+                        glm::vec3 m(mid.x, poly.centre.y, mid.y);
+                        links[i].push_back({j, glm::length(m - poly.centre) + glm::length(polys[j].centre - m), m, m});
+
+                    }
+                }
+
+            }
+
+            if (poly.blocked || !(poly.boundary[0] || poly.boundary[1] || poly.boundary[2])) {
+                return;
+            }
+
+            // triangles of other platforms within stepping, dropping or jumping distance of the edge of this one
+            polys_in_box(poly_lo(i) - glm::vec2(max_reach), poly_hi(i) + glm::vec2(max_reach), near);
+            for (int j : near) {
+
+                int q = polys[j].platform;
+                float dy = platforms[q].y - poly.y;
+
+                if (q == poly.platform || polys[j].blocked || dy < -agent.max_drop || dy > agent.jump_height()) {
+                    continue;
+                }
+
+                bool jump = abs(dy) > agent.step_height;
+                float reach = jump ? agent.jump_reach(dy) : agent.r;
+
+                glm::vec2 gap = glm::max(poly_lo(j) - poly_hi(i), poly_lo(i) - poly_hi(j));
+                if (gap.x > reach || gap.y > reach) {
+                    continue;
+                }
+
+                // reach comes from a jump whenever it isn't a step, so the arc goes up before it comes down even when landing lower
+                float y_lo = min(poly.y, platforms[q].y);
+                float y_hi = max(poly.y, platforms[q].y) + agent.height;
+                if (jump) {
+                    y_hi += agent.jump_height();
+                }
+
+                glm::vec2 c2(polys[j].centre.x, polys[j].centre.z);
+                NavLink best = {-1, INFINITY};
+
+                for (int e = 0; e < 3; e++) {
+
+                    if (!poly.boundary[e]) {
+                        continue;
+                    }
+
+                    // leave towards the middle of the other triangle, or from where the gap is smallest if that's too far
+                    glm::vec2 a = closest_point_on_segment(c2, poly.v[e], poly.v[(e+1)%3]);
+                    glm::vec2 b = closest_point_on_triangle(a, polys[j].v[0], polys[j].v[1], polys[j].v[2]);
+
+                    if (glm::length(b - a) > reach) {
+
+                        float d = INFINITY;
+                        for (int k = 0; k < 3; k++) {
+                            glm::vec2 ka, kb;
+                            float kd = segment_closest_points(poly.v[e], poly.v[(e+1)%3], polys[j].v[k], polys[j].v[(k+1)%3], ka, kb);
+                            if (kd < d) {
+                                d = kd;
+                                a = ka;
+                                b = kb;
+                            }
+                        }
+
+                        if (d > reach) {
+                            continue;
+                        }
+
+                    }
+
+                    // land a bit inside the other triangle rather than on its edge
+                    glm::vec2 to_centre = c2 - b;
+                    if (glm::length(to_centre) > 0) {
+                        b += glm::normalize(to_centre) * min(agent.r, glm::length(to_centre));
+                    }
+
+                    if (walkway_blocked(c1, a, poly.y, poly.y + agent.height) || walkway_blocked(a, b, y_lo, y_hi) || walkway_blocked(b, c2, platforms[q].y, platforms[q].y + agent.height)) {
+                        continue;
+                    }
+
+                    glm::vec3 p1(a.x, poly.centre.y, a.y);
+                    glm::vec3 p2(b.x, polys[j].centre.y, b.y);
+                    float cost = glm::length(p1 - poly.centre) + glm::length(p2 - p1) + glm::length(polys[j].centre - p2);
+
+                    if (cost < best.cost) {
+                        best = {j, cost, p1, p2};
+                    }
+
+                }
+
+                if (best.to != -1) {
+                    links[i].push_back(best);
+                }
+
+            }
+
+        });
+
+        // grow clusters over the links between triangles of the same platform
+        for (int i = 0; i < polys.size(); i++) {
+
+            if (polys[i].cluster != -1) {
+                continue;
+            }
+
+            NavCluster cluster;
+            queue<int> q;
+
+            polys[i].cluster = clusters.size();
+            q.push(i);
+
+            while (!q.empty() && cluster.polys.size() < NAV_CLUSTER_SIZE) {
+
+                int u = q.front();
+                q.pop();
+                cluster.polys.push_back(u);
+
+                for (NavLink& link : links[u]) {
+                    if (polys[link.to].cluster == -1 && polys[link.to].platform == polys[u].platform) {
+                        polys[link.to].cluster = clusters.size();
+                        q.push(link.to);
+                    }
+                }
+
+            }
+
+            // triangles that were queued but didn't fit start clusters of their own
+            while (!q.empty()) {
+                polys[q.front()].cluster = -1;
+                q.pop();
+            }
+
+            glm::vec3 sum(0.0);
+            for (int u : cluster.polys) {
+                sum += polys[u].centre;
+            }
+            cluster.centre = sum / (float)cluster.polys.size();
+
+            clusters.push_back(cluster);
+
+        }
+
+        cluster_links.resize(clusters.size());
+        set<pair<int, int>> linked;
+        for (int i = 0; i < polys.size(); i++) {
+            for (NavLink& link : links[i]) {
+                int c1 = polys[i].cluster;
+                int c2 = polys[link.to].cluster;
+                if (c1 != c2 && linked.insert({c1, c2}).second) {
+                    cluster_links[c1].push_back({c2, glm::length(clusters[c2].centre - clusters[c1].centre), clusters[c1].centre, clusters[c2].centre});
+                }
+            }
+        }
+
+    }
+
+    glm::vec2 poly_lo(int i) {
+        return glm::min(glm::min(polys[i].v[0], polys[i].v[1]), polys[i].v[2]);
+    }
+
+    glm::vec2 poly_hi(int i) {
+        return glm::max(glm::max(polys[i].v[0], polys[i].v[1]), polys[i].v[2]);
+    }
+
+    // triangles in the grid cells overlapping the box from lo to hi, each once and in index order
+    void polys_in_box(glm::vec2 lo, glm::vec2 hi, vector<int>& res) {
+
+        res.clear();
+
+        for (int x = floor(lo.x / NAV_CELL_SIZE); x <= floor(hi.x / NAV_CELL_SIZE); x++) {
+            for (int z = floor(lo.y / NAV_CELL_SIZE); z <= floor(hi.y / NAV_CELL_SIZE); z++) {
+                auto it = grid.find(cell_key(x, z));
+                if (it != grid.end()) {
+                    res.insert(res.end(), it->second.begin(), it->second.end());
+                }
+            }
+        }
+
+        sort(res.begin(), res.end());
+        res.erase(unique(res.begin(), res.end()), res.end());
+
+    }
+
+    // whether an agent moving along a segment would hit a wall overlapping the heights y_lo to y_hi
+    bool walkway_blocked(glm::vec2 a, glm::vec2 b, float y_lo, float y_hi) {
+
+        thread_local vector<int> near;
+        walls.walls_in_box(glm::min(a, b) - glm::vec2(agent.r), glm::max(a, b) + glm::vec2(agent.r), near);
+
+        for (int i : near) {
+
+            Wall& wall = walls.walls[i];
+
+            if (y_lo > wall.y_hi || y_hi < wall.y_lo) {
+                continue;
+            }
+
+            // same as testing against the wall inflated by the agent radius
+            if (segment_distance(a, b, wall.p1, wall.p2) < agent.r) {
+                return true;
+            }
+
+        }
+
+        return false;
+
+    }
+
+    // triangle an agent at p is standing on (or would land on when falling), -1 if there is none,
+    // if that triangle is too close to a wall to have links the nearest one on the same platform that has them is used
+    int find_poly(glm::vec3 p) {
+
+        float feet = p.y - agent.height / 2;
+        glm::vec2 p2(p.x, p.z);
+
+        auto it = grid.find(cell_key(floor(p.x / NAV_CELL_SIZE), floor(p.z / NAV_CELL_SIZE)));
+        if (it == grid.end()) {
+            return -1;
+        }
+
+        int res = -1;
+        for (int i : it->second) {
+            if (polys[i].y <= feet + 0.01 && (res == -1 || polys[i].y > polys[res].y)) {
+                if (point_in_triangle(p2, polys[i].v[0], polys[i].v[1], polys[i].v[2])) {
+                    res = i;
+                }
+            }
+        }
+
+        if (res == -1 || !polys[res].blocked) {
+            return res;
+        }
+
+        // agents pressed against a wall stand on triangles without links, use the closest one of the platform they can leave from
+        int platform = polys[res].platform;
+        float best = INFINITY;
+        res = -1;
+
+        for (int x = floor(p.x / NAV_CELL_SIZE) - 1; x <= floor(p.x / NAV_CELL_SIZE) + 1; x++) {
+            for (int z = floor(p.z / NAV_CELL_SIZE) - 1; z <= floor(p.z / NAV_CELL_SIZE) + 1; z++) {
+
+                auto cell = grid.find(cell_key(x, z));
+                if (cell == grid.end()) {
+                    continue;
+                }
+
+                for (int i : cell->second) {
+                    if (polys[i].platform != platform || polys[i].blocked) {
+                        continue;
+                    }
+                    float d = glm::length(closest_point_on_triangle(p2, polys[i].v[0], polys[i].v[1], polys[i].v[2]) - p2);
+                    if (d < best || (d == best && i < res)) {
+                        best = d;
+                        res = i;
+                    }
+                }
+
+            }
+        }
+
+        return res;
+
+    }
+
+    // path of clusters between two clusters, from the cache if it has been searched for before
+    bool find_corridor(int start, int goal, vector<int>& corridor) {
+
+        long long key = ((long long)start << 32) | goal;
+
+        {
+            lock_guard<mutex> lock(cache_mutex);
+            auto it = corridor_cache.find(key);
+            if (it != corridor_cache.end()) {
+                corridor = it->second;
+                return !corridor.empty();
+            }
+        }
+
+        bool found = a_star(clusters, cluster_links, start, goal, [](int) { return true; }, corridor);
+        if (!found) {
+            corridor.clear();
+        }
+
+        {
+            lock_guard<mutex> lock(cache_mutex);
+            if (corridor_cache.size() >= NAV_CACHE_SIZE) {
+                corridor_cache.clear();
+            }
+            corridor_cache[key] = corridor;
+        }
+
+        return found;
+
+    }
+
+    // waypoints for an agent to get from start to goal, both in the same space as Player::p
+    bool find_path(glm::vec3 start, glm::vec3 goal, vector<glm::vec3>& path) {
+
+        int s = find_poly(start);
+        int t = find_poly(goal);
+
+        if (s == -1 || t == -1) {
+            return false;
+        }
+
+        vector<int> corridor;
+        if (!find_corridor(polys[s].cluster, polys[t].cluster, corridor)) {
+            return false;
+        }
+
+        sort(corridor.begin(), corridor.end());
+        auto in_corridor = [&](int i) {
+            return binary_search(corridor.begin(), corridor.end(), polys[i].cluster);
+        };
+
+        vector<int> poly_path;
+        if (!a_star(polys, links, s, t, in_corridor, poly_path)) {
+            // the corridor is only an estimate, search the whole mesh if the way isn't inside it
+            if (!a_star(polys, links, s, t, [](int) { return true; }, poly_path)) {
+                return false;
+            }
+        }
+
+        path.clear();
+        path.push_back(start);
+
+        for (int i = 0; i + 1 < poly_path.size(); i++) {
+            for (NavLink& link : links[poly_path[i]]) {
+                if (link.to == poly_path[i+1]) {
+                    path.push_back(link.p1);
+                    if (link.p2 != link.p1) {
+                        path.push_back(link.p2);
+                    }
+                    break;
+                }
+            }
+        }
+
+        path.push_back(goal);
+
+        return true;
+
+    }
+
+};
+
+int main() {
+
+    if (!glfwInit()) {
+        cerr << "GLFW init failed." << endl;
+        exit(1);
+    }
+
+    int ww = 800;
+    int wh = 800;
+
+    GLFWwindow* window;
+    window = glfwCreateWindow(ww, wh, "this is a window", NULL, NULL);
+    glfwMakeContextCurrent(window);
+
+    if (glewInit() != GLEW_OK) {
+        cerr << "GLEW init failed." << endl;
+        exit(1);
+    }
+
+    ShaderProgram worldspace_program("../src/shaders/worldspace.vert", "../src/shaders/worldspace.frag", {
+        "tex",
+        "view_mat",
+        "project_mat",
+    });
+    worldspace_program.use();
+
+    ShaderProgram default_program("../src/shaders/default.vert", "../src/shaders/default.frag", {
+        "tex"
+    });
+
+    Tex2D tex("../textures/bricks.png");
+
+    vector<float> vertices = {
+        // -1.0f, -1.0f, 1.0f,
+        // 1.0f, -1.0f, 1.0f,
+        // 1.0f, 1.0f, 1.0f,
+        // -1.0f, -1.0f, 1.0f,
+        // -1.0f, 1.0f, 1.0f,
+        // 1.0f, 1.0f, 1.0f,
+    };
+
+    
+
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    double mx, my;
+    glfwGetCursorPos(window, &mx, &my);
+
+
+    JobSystem jobs(max(1u, thread::hardware_concurrency()) - 1);
+
+    // player and level stuff
+    float g = 2.0;
+    float jump_v = 1.0;
+    float max_v = 5.0f;
+    Player plr(glm::vec3(0.0, 1.0, 0.0));
+
+    vector<Platform> platforms;
+    platforms.push_back(Platform(-1.0f, {{-1.0, -1.0}, {1.0, -1.0}, {1.0, 1.0}, {-1.0, 1.0}, {0.0, 0.0}}));
+
+    vector<Wall> walls;
+    walls.push_back(Wall({-1.0, 1.0}, {2.0, 1.0}, -1.0, 1.0));
+    walls.push_back(Wall({-1.0, 1.0}, {-1.0, -1.0}, -1.0, 1.0));
+    WallGrid wall_grid(walls);
+
+    for (Wall wall : walls) {
+        wall_to_mesh(vertices, wall);
+    }
+
+    for (Platform platform : platforms) {
+        platform_to_mesh(vertices, platform);
+    }
+
+    // npcs, projectiles and props, nothing spawns them until they can be drawn
+    Bodies bodies;
+
+    NavMesh navmesh(platforms, walls, NavAgent(plr, g, jump_v), jobs);
+    cout << "Navmesh: " << navmesh.polys.size() << " triangles in " << navmesh.clusters.size() << " clusters" << endl;
+
+
+    VAO vao;
+    vao.bind();
+
+    VBO vbo(vertices);
+    // EBO ebo(indices);
+
+    vao.link_VBO(vbo, 0, 3);
+    vao.unbind();
+    vbo.unbind();
+
+    glEnable(GL_DEPTH_TEST);
+
+    // glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
+
+    double time_when_fps = glfwGetTime();
+    int updates_since_fps = 0;
+    float dt = 0.0f;
+
+    while (!glfwWindowShouldClose(window)) {
+        
+        float time_start = glfwGetTime();
+
+        glfwPollEvents();
+
+        double n_mx, n_my;
+        glfwGetCursorPos(window, &n_mx, &n_my);
+        double dmx = n_mx - mx;
+        double dmy = n_my - my;
+        mx = n_mx;
+        my = n_my;
+
+        plr.yaw -= dmx / 100;
+        plr.pitch -= dmy / 100;
+        plr.pitch = min(plr.pitch, (float)PI/2);
+        plr.pitch = max(plr.pitch, -(float)PI/2);
+
+        plr.v.x = 0.0;
+        plr.v.z = 0.0;
+        plr.v.y -= g * dt;
+        plr.v.y = max(plr.v.y, -max_v);
+
+        if (glfwGetKey(window, GLFW_KEY_ESCAPE)) {
+            break;
+        }
+        if (glfwGetKey(window, GLFW_KEY_W)) {
+            plr.v.z -= cos(plr.yaw) * plr.speed;
+            plr.v.x -= sin(plr.yaw) * plr.speed;
+        }
+        if (glfwGetKey(window, GLFW_KEY_S)) {
+            plr.v.z += cos(plr.yaw) * plr.speed;
+            plr.v.x += sin(plr.yaw) * plr.speed;
+        }
+        if (glfwGetKey(window, GLFW_KEY_D)) {
+            plr.v.z += -sin(plr.yaw) * plr.speed;
+            plr.v.x += cos(plr.yaw) * plr.speed;
+        }
+        if (glfwGetKey(window, GLFW_KEY_A)) {
+            plr.v.z -= -sin(plr.yaw) * plr.speed;
+            plr.v.x -= cos(plr.yaw) * plr.speed;
+        }
+        if (glfwGetKey(window, GLFW_KEY_SPACE)) {
+            if (plr.on_platform) {
+               plr.v.y = jump_v;
+               plr.on_platform = false;
+            }
+            // plr.v.y += dt * plr.speed;
+        }
+        // if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT)) {
+        //     plr.v.y -= dt * plr.speed;
+        // }
+
+        plr.p += plr.v * dt;
+
+        // walls first so that platforms are checked where the body actually ended up
+        collide_walls(plr.p, plr.v, plr.r, plr.height, dt, wall_grid);
+        collide_platforms(plr.p, plr.v, plr.height, plr.on_platform, dt, platforms);
+
+        jobs.parallel_for(bodies.size(), BODY_BATCH_SIZE, [&](int begin, int end) {
+            integrate_bodies(bodies, begin, end, g, max_v, dt);
+        });
+        jobs.parallel_for(bodies.size(), BODY_BATCH_SIZE, [&](int begin, int end) {
+            collide_bodies(bodies, begin, end, dt, platforms, wall_grid);
+        });
 
         glfwGetWindowSize(window, &ww, &wh);
         glViewport(0, 0, ww, wh);